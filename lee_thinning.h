@@ -3,6 +3,8 @@ __author__    = 'Meher Niger <mniger@uh.edu>'
 __copyright__ = 'Copyright 2025 by Meher Niger'
 */
 
+#pragma once
+
 #include <tira/volume.h>
 #include <vector>
 #include <array>
@@ -12,6 +14,7 @@ __copyright__ = 'Copyright 2025 by Meher Niger'
 #include <iostream>
 #include <algorithm>
 #include <numeric>
+#include <cstdint>
 
 
 using Volume = tira::volume<int>;
@@ -578,6 +581,51 @@ bool is_simple_point(const std::array<uint8_t, 27>& neighbors) {
     return true;
 }
 
+// Collects the simple border points of one directional pass (border 1..6 = N, S, E, W, U, B)
+// for the planes zBegin <= z < zEnd. The volume is only read, so slabs can be scanned independently.
+void collect_simple_border_points(Volume& volume, int currentBorder, const std::array<int, 256>& eulerLUT,
+    int zBegin, int zEnd, PointList& simpleBorderPoints) {
+    int width = volume.X();
+    int height = volume.Y();
+
+    for (int z = zBegin; z < zEnd; z++) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (get_pixel_nocheck(volume, x, y, z) != 1)
+                    continue;
+
+                bool isBorderPoint = false;
+
+                if (currentBorder == 1 && N(volume, x, y, z) <= 0) isBorderPoint = true;
+                if (currentBorder == 2 && S(volume, x, y, z) <= 0) isBorderPoint = true;
+                if (currentBorder == 3 && E(volume, x, y, z) <= 0) isBorderPoint = true;
+                if (currentBorder == 4 && W(volume, x, y, z) <= 0) isBorderPoint = true;
+                if (currentBorder == 5 && U(volume, x, y, z) <= 0) isBorderPoint = true;
+                if (currentBorder == 6 && B(volume, x, y, z) <= 0) isBorderPoint = true;
+
+                if (!isBorderPoint)
+                    continue;
+
+                if (is_endpoint(volume, x, y, z))
+                    continue;
+
+                std::array<int, 27> neighborhood_int = get_neighborhood(volume, x, y, z);
+                std::array<uint8_t, 27> neighborhood;
+                for (int i = 0; i < 27; ++i) neighborhood[i] = static_cast<uint8_t>(neighborhood_int[i]);
+
+                if (!is_euler_invariant(neighborhood, eulerLUT))
+                    continue;
+
+                if (!is_simple_point(neighborhood))
+                    continue;
+
+
+                simpleBorderPoints.push_back({ x, y, z });
+            }
+        }
+    }
+}
+
 /*
 * Main function that performs thinning by iterating through each of the 6 borders. For each voxel, it checks:
 
@@ -593,11 +641,15 @@ If all conditions are met, the voxel is queued for deletion. After each pass,
 a second pass confirms deletability to prevent conflicts, then deletion proceeds.
 This loop continues until no voxels are deleted in 6 successive directional passes.
 
+If peelDepth is given, it is resized to X*Y*Z and receives, for every deleted voxel,
+the iteration at which it was peeled away (0 for background and surviving voxels).
+Indexing is (z * Y + y) * X + x. Depths saturate at 65535.
+
 
 */
 
 
-void computeThinImage(Volume& volume) {
+void computeThinImage(Volume& volume, std::vector<uint16_t>* peelDepth = nullptr) {
     int width = volume.X();
     int height = volume.Y();
     int depth = volume.Z();
@@ -610,6 +662,9 @@ void computeThinImage(Volume& volume) {
     int iterations = 0;
     int unchangedBorders = 0;
 
+    if (peelDepth)
+        peelDepth->assign(static_cast<size_t>(width) * height * depth, 0);
+
     while (unchangedBorders < 6) {
         unchangedBorders = 0;
         iterations++;
@@ -617,42 +672,7 @@ void computeThinImage(Volume& volume) {
         for (int currentBorder = 1; currentBorder <= 6; currentBorder++) {
             bool noChange = true;
 
-            for (int z = 0; z < depth; z++) {
-                for (int y = 0; y < height; y++) {
-                    for (int x = 0; x < width; x++) {
-                        if (get_pixel_nocheck(volume, x, y, z) != 1)
-                            continue;
-
-                        bool isBorderPoint = false;
-
-                        if (currentBorder == 1 && N(volume, x, y, z) <= 0) isBorderPoint = true;
-                        if (currentBorder == 2 && S(volume, x, y, z) <= 0) isBorderPoint = true;
-                        if (currentBorder == 3 && E(volume, x, y, z) <= 0) isBorderPoint = true;
-                        if (currentBorder == 4 && W(volume, x, y, z) <= 0) isBorderPoint = true;
-                        if (currentBorder == 5 && U(volume, x, y, z) <= 0) isBorderPoint = true;
-                        if (currentBorder == 6 && B(volume, x, y, z) <= 0) isBorderPoint = true;
-
-                        if (!isBorderPoint)
-                            continue;
-
-                        if (is_endpoint(volume, x, y, z))
-                            continue;
-
-                        std::array<int, 27> neighborhood_int = get_neighborhood(volume, x, y, z);
-                        std::array<uint8_t, 27> neighborhood;
-                        for (int i = 0; i < 27; ++i) neighborhood[i] = static_cast<uint8_t>(neighborhood_int[i]);
-
-                        if (!is_euler_invariant(neighborhood, eulerLUT))
-                            continue;
-
-                        if (!is_simple_point(neighborhood))
-                            continue;
-
-
-                        simpleBorderPoints.push_back({ x, y, z });
-                    }
-                }
-            }
+            collect_simple_border_points(volume, currentBorder, eulerLUT, 0, depth, simpleBorderPoints);
 
             for (const auto& index : simpleBorderPoints) {
                 std::array<int, 27> neighbors_int = get_neighborhood(volume, index[0], index[1], index[2]);
@@ -662,6 +682,11 @@ void computeThinImage(Volume& volume) {
                 if (is_simple_point(neighbors)) {
                     set_pixel(volume, index[0], index[1], index[2], 0);
                     noChange = false;
+
+                    if (peelDepth) {
+                        size_t i = (static_cast<size_t>(index[2]) * height + index[1]) * width + index[0];
+                        (*peelDepth)[i] = static_cast<uint16_t>(std::min(iterations, 65535));
+                    }
                 }
 
             }
@@ -674,9 +699,69 @@ void computeThinImage(Volume& volume) {
     }
 }
 
-// Lee thinning function that directly works with tira::volume<int>
-void lee(tira::volume<int>& in, tira::volume<int>& out, int x, int y, int z) {
-    
+/**
+     * Estimate the local radius at every skeleton voxel from the peel order
+     * recorded by computeThinImage. The deepest peel depth in the 26-neighborhood
+     * of a skeleton voxel counts the layers removed around it. Since the six
+     * directional passes also eat into diagonals, one iteration removes about
+     * sqrt(2) voxels of radius on a round cross-section, hence the default scale
+     * (use 1 for box-like objects). Voxels with no peeled neighbor get 0.5.
+     * The default only holds for tubes aligned with an axis: an iteration erodes
+     * roughly one Chebyshev step, so the cross-section of an oblique vessel is
+     * eroded like a 3D cube and its radius comes out biased.
+     *
+     * @param skeleton thinned volume (1 = skeleton, 0 = background)
+     * @param peelDepth per-voxel peel iteration filled by computeThinImage; if its size
+     *        is not X*Y*Z (e.g. empty), points and radii are left empty
+     * @param points receives the coordinates of every skeleton voxel
+     * @param radii receives the radius (in voxels) of the matching point
+     * @param scale voxels of radius removed per iteration
+     */
+void skeleton_radii(Volume& skeleton, const std::vector<uint16_t>& peelDepth, PointList& points, std::vector<float>& radii,
+    float scale = 1.41421356f) {
+    int width = skeleton.X();
+    int height = skeleton.Y();
+    int depth = skeleton.Z();
+
+    points.clear();
+    radii.clear();
+
+    // the buffer must come from thinning this very volume
+    if (peelDepth.size() != static_cast<size_t>(width) * height * depth)
+        return;
+
+    for (int z = 0; z < depth; z++) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (get_pixel_nocheck(skeleton, x, y, z) != 1)
+                    continue;
+
+                int maxDepth = 0;
+                for (int dz = -1; dz <= 1; dz++) {
+                    int nz = z + dz;
+                    if (nz < 0 || nz >= depth) continue;
+                    for (int dy = -1; dy <= 1; dy++) {
+                        int ny = y + dy;
+                        if (ny < 0 || ny >= height) continue;
+                        for (int dx = -1; dx <= 1; dx++) {
+                            int nx = x + dx;
+                            if (nx < 0 || nx >= width) continue;
+                            size_t i = (static_cast<size_t>(nz) * height + ny) * width + nx;
+                            maxDepth = std::max(maxDepth, static_cast<int>(peelDepth[i]));
+                        }
+                    }
+                }
+
+                points.push_back({ x, y, z });
+                radii.push_back(std::max(maxDepth * scale, 0.5f));
+            }
+        }
+    }
+}
+
+// Binarizes in, thins it in place (optionally recording the peel depth) and copies the result to out
+void lee_thin(tira::volume<int>& in, tira::volume<int>& out, int x, int y, int z, std::vector<uint16_t>* peelDepth) {
+
     out = tira::volume<int>(x, y, z);
 
     //  Binarize 
@@ -692,7 +777,7 @@ void lee(tira::volume<int>& in, tira::volume<int>& out, int x, int y, int z) {
     }
 
     // Lee's 3D thinning 
-    computeThinImage(in);
+    computeThinImage(in, peelDepth);
 
     // Copy the result to the output volume
     for (int zi = 0; zi < z; ++zi) {
@@ -704,3 +789,15 @@ void lee(tira::volume<int>& in, tira::volume<int>& out, int x, int y, int z) {
     }
 }
 
+// Lee thinning function that directly works with tira::volume<int>
+void lee(tira::volume<int>& in, tira::volume<int>& out, int x, int y, int z) {
+    lee_thin(in, out, x, y, z, nullptr);
+}
+
+// Lee thinning that also returns every skeleton voxel with its radius estimate,
+// taken from the peel order so no separate distance transform is needed
+void lee(tira::volume<int>& in, tira::volume<int>& out, int x, int y, int z, PointList& points, std::vector<float>& radii) {
+    std::vector<uint16_t> peelDepth;
+    lee_thin(in, out, x, y, z, &peelDepth);
+    skeleton_radii(out, peelDepth, points, radii);
+}
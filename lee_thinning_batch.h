@@ -0,0 +1,257 @@
+/*
+__author__    = 'Meher Niger <mniger@uh.edu>'
+__copyright__ = 'Copyright 2025 by Meher Niger'
+*/
+
+// Batch Lee thinning of many independent volumes.
+// One loader thread decodes inputs, a work-stealing pool thins them and one writer thread
+// stores the results, so load, thin and store of different volumes overlap.
+
+#pragma once
+
+#include "lee_thinning.h"
+#include <functional>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+
+// One volume of a batch. load fills the volume from its input source and store writes the
+// skeleton to its output; both return false on failure. voxels is a size hint used to start
+// the largest volumes first (0 if unknown).
+struct BatchJob {
+    std::function<bool(Volume&)> load;
+    std::function<bool(Volume&)> store;
+    size_t voxels = 0;
+};
+
+// Per-job timing in seconds, in the order of the input jobs
+struct BatchTiming {
+    double load = 0;
+    double thin = 0;
+    double store = 0;
+    size_t voxels = 0;  // actual size after loading
+    int worker = -1;    // pool thread that thinned the volume
+    bool ok = false;
+};
+
+
+// Per-thread deque of loaded volumes. The owner takes from the front, idle threads steal from the back.
+struct BatchTask {
+    size_t job;
+    std::unique_ptr<Volume> volume;
+};
+
+struct BatchDeque {
+    std::mutex lock;
+    std::deque<BatchTask> tasks;
+};
+
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/**
+     * Thins every job of a batch. Jobs are loaded in order of decreasing size hint and handed
+     * to the pool round-robin; at most maxInFlight volumes are held in memory at once
+     * (being loaded, queued, thinned or stored).
+     *
+     * @param jobs input / output sources of every volume
+     * @param threads number of thinning threads (0 = hardware concurrency)
+     * @param maxInFlight bound on resident volumes (0 = threads + 2)
+     * @return timing and status of every job
+     */
+std::vector<BatchTiming> lee_batch(const std::vector<BatchJob>& jobs, int threads = 0, int maxInFlight = 0) {
+    if (threads <= 0) threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    if (maxInFlight <= 0) maxInFlight = threads + 2;
+
+    std::vector<BatchTiming> timings(jobs.size());
+
+    std::vector<size_t> order(jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+        [&](size_t a, size_t b) { return jobs[a].voxels > jobs[b].voxels; });
+
+    std::vector<BatchDeque> deques(threads);
+
+    // shared state of the pipeline, guarded by stateLock
+    std::mutex stateLock;
+    std::condition_variable slotFree, workReady, storeReady;
+    int inFlight = 0;
+    size_t queued = 0;
+    bool loadingDone = false;
+    int activeWorkers = threads;
+    std::deque<BatchTask> storeQueue;
+
+    auto release_slot = [&]() {
+        std::lock_guard<std::mutex> guard(stateLock);
+        inFlight--;
+        slotFree.notify_one();
+    };
+
+    std::thread loader([&]() {
+        for (size_t k = 0; k < order.size(); k++) {
+            size_t job = order[k];
+            {
+                std::unique_lock<std::mutex> guard(stateLock);
+                slotFree.wait(guard, [&]() { return inFlight < maxInFlight; });
+                inFlight++;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            std::unique_ptr<Volume> volume;
+            bool ok = false;
+            try {
+                volume.reset(new Volume());
+                ok = jobs[job].load && jobs[job].load(*volume);
+            }
+            catch (...) {
+                ok = false;
+            }
+            timings[job].load = seconds_since(start);
+
+            if (!ok) {
+                release_slot();
+                continue;
+            }
+            timings[job].voxels = static_cast<size_t>(volume->X()) * volume->Y() * volume->Z();
+
+            BatchDeque& target = deques[k % threads];
+            {
+                std::lock_guard<std::mutex> guard(target.lock);
+                target.tasks.push_back({ job, std::move(volume) });
+            }
+            {
+                std::lock_guard<std::mutex> guard(stateLock);
+                queued++;
+            }
+            workReady.notify_one();
+        }
+
+        std::lock_guard<std::mutex> guard(stateLock);
+        loadingDone = true;
+        workReady.notify_all();
+    });
+
+    auto take_task = [&](int self, BatchTask& task) {
+        {
+            BatchDeque& own = deques[self];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.front());
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for (int i = 1; i < threads; i++) {
+            BatchDeque& victim = deques[(self + i) % threads];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<std::thread> pool;
+    for (int self = 0; self < threads; self++) {
+        pool.emplace_back([&, self]() {
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> guard(stateLock);
+                    workReady.wait(guard, [&]() { return queued > 0 || loadingDone; });
+                    if (queued == 0 && loadingDone)
+                        break;
+                    queued--;
+                }
+
+                // queued counts tasks in the deques, so one is guaranteed to be found
+                BatchTask task;
+                while (!take_task(self, task))
+                    std::this_thread::yield();
+
+                auto start = std::chrono::steady_clock::now();
+                bool ok = false;
+                try {
+                    prepare_data(*task.volume);
+                    computeThinImage(*task.volume);
+                    ok = true;
+                }
+                catch (...) {
+                    ok = false;
+                }
+                timings[task.job].thin = seconds_since(start);
+                timings[task.job].worker = self;
+
+                // a failed volume is dropped here instead of going to the writer
+                if (!ok) {
+                    task.volume.reset();
+                    release_slot();
+                    continue;
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(stateLock);
+                    storeQueue.push_back(std::move(task));
+                }
+                storeReady.notify_one();
+            }
+
+            std::lock_guard<std::mutex> guard(stateLock);
+            activeWorkers--;
+            storeReady.notify_one();
+        });
+    }
+
+    std::thread writer([&]() {
+        while (true) {
+            BatchTask task;
+            {
+                std::unique_lock<std::mutex> guard(stateLock);
+                storeReady.wait(guard, [&]() { return !storeQueue.empty() || activeWorkers == 0; });
+                if (storeQueue.empty())
+                    break;
+                task = std::move(storeQueue.front());
+                storeQueue.pop_front();
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            bool ok = false;
+            try {
+                ok = jobs[task.job].store && jobs[task.job].store(*task.volume);
+            }
+            catch (...) {
+                ok = false;
+            }
+            timings[task.job].store = seconds_since(start);
+            timings[task.job].ok = ok;
+
+            task.volume.reset();
+            release_slot();
+        }
+    });
+
+    loader.join();
+    for (auto& t : pool) t.join();
+    writer.join();
+
+    return timings;
+}
+
+// Prints one line per job (index, voxels, worker, load / thin / store seconds, status)
+void print_batch_timings(const std::vector<BatchTiming>& timings, std::ostream& out = std::cout) {
+    out << "job\tvoxels\tworker\tload_s\tthin_s\tstore_s\tok\n";
+    for (size_t i = 0; i < timings.size(); i++) {
+        const BatchTiming& t = timings[i];
+        out << i << '\t' << t.voxels << '\t' << t.worker << '\t' << t.load << '\t'
+            << t.thin << '\t' << t.store << '\t' << (t.ok ? 1 : 0) << '\n';
+    }
+}
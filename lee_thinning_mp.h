@@ -0,0 +1,418 @@
+/*
+__author__    = 'Meher Niger <mniger@uh.edu>'
+__copyright__ = 'Copyright 2025 by Meher Niger'
+*/
+
+// Multi-process Lee thinning for a single Linux machine (POSIX shared memory, fork).
+// The volume is split along z into slabs, one per worker process. Each worker is pinned
+// to a NUMA node, loads its own slab through a callback into private memory (so pages are
+// first-touched locally) and stores it the same way; no process ever holds the whole volume.
+// Only the first and last plane of every slab are published through shared memory.
+
+#pragma once
+
+#include "lee_thinning.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <signal.h>
+#include <pthread.h>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <atomic>
+#include <functional>
+
+
+// Shared control block. It is followed in the segment by
+//   int changed[workers]                 (per-rank "deleted something" flag of the current pass)
+//   uint8_t planes[workers][2][X * Y]    (first and last plane of every slab)
+struct MPControl {
+    pthread_barrier_t barrier;
+    int workers;
+    int done;
+};
+
+
+// Parses a sysfs cpu/node list such as "0-3,8,10-11"
+std::vector<int> parse_cpulist(const std::string& list) {
+    std::vector<int> ids;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) comma = list.size();
+        std::string range = list.substr(pos, comma - pos);
+        size_t dash = range.find('-');
+        if (!range.empty() && range[0] >= '0' && range[0] <= '9') {
+            int first = std::stoi(range);
+            int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+            for (int i = first; i <= last; ++i) ids.push_back(i);
+        }
+        pos = comma + 1;
+    }
+    return ids;
+}
+
+std::vector<int> read_sysfs_list(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    if (!file || !std::getline(file, line))
+        return {};
+    return parse_cpulist(line);
+}
+
+// Online NUMA nodes, or an empty list when sysfs does not expose them
+std::vector<int> numa_nodes() {
+    return read_sysfs_list("/sys/devices/system/node/online");
+}
+
+// CPUs of one NUMA node, or an empty list if the node is unknown
+std::vector<int> numa_node_cpus(int node) {
+    return read_sysfs_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+}
+
+// Pins the calling process to the given CPUs (no-op for an empty list). Does not allocate,
+// so it is safe in a freshly forked worker.
+void pin_to_cpus(const std::vector<int>& cpus) {
+    if (cpus.empty())
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+// Maps a POSIX shared memory segment of the given size, zero filled, or returns nullptr.
+// The name is unlinked right away; workers inherit the mapping through fork.
+void* map_shared_segment(size_t bytes) {
+    static std::atomic<unsigned> segmentCounter{ 0 };
+    std::string name = "/lee_thinning_" + std::to_string(getpid()) + "_" + std::to_string(segmentCounter++);
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return nullptr;
+    shm_unlink(name.c_str());
+
+    // ftruncate alone reserves nothing on tmpfs; touching a page past a full /dev/shm would raise SIGBUS
+    if (posix_fallocate(fd, 0, static_cast<off_t>(bytes)) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return nullptr;
+
+    std::memset(mem, 0, bytes);
+    return mem;
+}
+
+
+// Reads (load) or writes (store) the planes z0 <= z < z1 of one slab. Plane z of the volume
+// is slab(x, y, z - z0 + 1); planes 0 and z1 - z0 + 1 of the slab are halos and must be left
+// alone. Runs inside the worker process that owns the slab.
+using SlabIO = std::function<bool(Volume& slab, int z0, int z1)>;
+
+
+// Copies one plane of the local slab to / from a shared plane buffer
+void store_plane(Volume& vol, int z, uint8_t* plane) {
+    int width = vol.X();
+    int height = vol.Y();
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            plane[y * width + x] = static_cast<uint8_t>(vol(x, y, z));
+}
+
+void load_plane(Volume& vol, int z, const uint8_t* plane) {
+    int width = vol.X();
+    int height = vol.Y();
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            vol(x, y, z) = plane[y * width + x];
+}
+
+
+/*
+* Body of one worker process. The local slab holds the owned planes at 1..n and one halo
+* plane on each side (0 and n + 1), which stays 0 at the outer faces of the volume.
+
+Every directional pass runs as:
+
+collect the candidates of the owned planes (read only, so all ranks do it at once)
+
+re-check and delete candidates in the interior planes 2..n-1, whose neighborhood
+never reaches another slab (all ranks at once)
+
+re-check and delete candidates in the two boundary planes, one rank after another,
+each rank first pulling its neighbours' freshly published planes into its halo
+
+Deletion stays a sequence of single simple-point removals, so topology is preserved
+exactly as in computeThinImage, although the order (and so the skeleton) may differ.
+Rank 0 acts as coordinator: it reduces the per-rank change flags after every pass and
+stops the run after an iteration with six unchanged borders across all ranks.
+*/
+bool thin_slab_worker(int width, int height, int depth, const SlabIO& load, const SlabIO& store,
+    MPControl* ctl, int rank, const std::vector<int>& cpus) {
+    pin_to_cpus(cpus);
+
+    int workers = ctl->workers;
+    size_t planeSize = static_cast<size_t>(width) * height;
+
+    int* changed = reinterpret_cast<int*>(ctl + 1);
+    uint8_t* planes = reinterpret_cast<uint8_t*>(changed + workers);
+    auto firstPlane = [&](int r) { return planes + (2 * static_cast<size_t>(r)) * planeSize; };
+    auto lastPlane = [&](int r) { return planes + (2 * static_cast<size_t>(r) + 1) * planeSize; };
+
+    int z0 = static_cast<int>(static_cast<long long>(depth) * rank / workers);
+    int z1 = static_cast<int>(static_cast<long long>(depth) * (rank + 1) / workers);
+    int n = z1 - z0;
+
+    // allocated after pinning so the slab lives on the local node
+    Volume slab(width, height, n + 2);
+    if (!load(slab, z0, z1))
+        return false;
+
+    //  Binarize the owned planes
+    for (int z = 1; z <= n; z++)
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                slab(x, y, z) = (slab(x, y, z) != 0) ? 1 : 0;
+
+    auto publish = [&]() {
+        store_plane(slab, 1, firstPlane(rank));
+        store_plane(slab, n, lastPlane(rank));
+    };
+    auto pull_halos = [&]() {
+        if (rank > 0) load_plane(slab, 0, lastPlane(rank - 1));
+        if (rank < workers - 1) load_plane(slab, n + 1, firstPlane(rank + 1));
+    };
+    auto delete_if_simple = [&](const Point& p) {
+        std::array<int, 27> neighbors_int = get_neighborhood(slab, p[0], p[1], p[2]);
+        std::array<uint8_t, 27> neighbors;
+        for (int i = 0; i < 27; ++i) neighbors[i] = static_cast<uint8_t>(neighbors_int[i]);
+
+        if (!is_simple_point(neighbors))
+            return false;
+        set_pixel(slab, p[0], p[1], p[2], 0);
+        return true;
+    };
+
+    // initial halos
+    publish();
+    pthread_barrier_wait(&ctl->barrier);
+    pull_halos();
+    pthread_barrier_wait(&ctl->barrier);
+
+    std::array<int, 256> eulerLUT = fill_euler_LUT();
+    PointList simpleBorderPoints;
+    int unchangedBorders = 0;
+
+    while (true) {
+        if (rank == 0) unchangedBorders = 0;
+
+        for (int currentBorder = 1; currentBorder <= 6; currentBorder++) {
+            bool noChange = true;
+
+            simpleBorderPoints.clear();
+            collect_simple_border_points(slab, currentBorder, eulerLUT, 1, n + 1, simpleBorderPoints);
+
+            for (const auto& p : simpleBorderPoints)
+                if (p[2] > 1 && p[2] < n && delete_if_simple(p))
+                    noChange = false;
+
+            for (int turn = 0; turn < workers; turn++) {
+                if (turn == rank) {
+                    pull_halos();
+                    for (const auto& p : simpleBorderPoints)
+                        if ((p[2] == 1 || p[2] == n) && delete_if_simple(p))
+                            noChange = false;
+                    publish();
+                }
+                pthread_barrier_wait(&ctl->barrier);
+            }
+
+            changed[rank] = noChange ? 0 : 1;
+            pthread_barrier_wait(&ctl->barrier);
+
+            // nobody may publish again (turn 0 of the next pass) before every rank has read its halos
+            pull_halos();
+            pthread_barrier_wait(&ctl->barrier);
+
+            if (rank == 0) {
+                bool globalNoChange = true;
+                for (int r = 0; r < workers; r++) {
+                    if (changed[r]) globalNoChange = false;
+                    changed[r] = 0;
+                }
+                if (globalNoChange)
+                    unchangedBorders++;
+            }
+        }
+
+        if (rank == 0)
+            ctl->done = (unchangedBorders == 6);
+        pthread_barrier_wait(&ctl->barrier);
+        if (ctl->done)
+            break;
+    }
+
+    return store(slab, z0, z1);
+}
+
+
+/**
+     * Lee thinning of a width x height x depth volume by several worker processes on one
+     * machine, without the volume ever being held by a single process. Worker r owns the
+     * planes depth*r/workers <= z < depth*(r+1)/workers: it loads them with load, binarizes
+     * them (anything non-zero is foreground), thins and hands them to store. Each worker
+     * holds 4 bytes per voxel of its own slab; the shared segment holds two planes per worker.
+     *
+     * The workers are forked and then allocate and run the callbacks, which POSIX only allows
+     * in a child of a single-threaded process: do not call this while other threads are running.
+     *
+     * @param width, height, depth size of the volume
+     * @param load fills the owned planes of a slab (see SlabIO)
+     * @param store writes the thinned owned planes of a slab (see SlabIO)
+     * @param workers number of worker processes (0 = one per NUMA node); capped at depth
+     * @return false if shared memory or a worker could not be set up, a load or store
+     *         failed or a worker died; some slabs may have been stored in that case
+     */
+bool computeThinImageMP(int width, int height, int depth, const SlabIO& load, const SlabIO& store, int workers = 0) {
+    if (depth <= 0)
+        return true;
+
+    // everything that allocates or reads files is done here, before forking
+    std::vector<int> nodes = numa_nodes();
+    if (nodes.empty()) nodes.push_back(-1);
+    if (workers <= 0) workers = static_cast<int>(nodes.size());
+    workers = std::min(workers, depth);
+
+    std::vector<std::vector<int>> rankCpus(workers);
+    for (int r = 0; r < workers; r++)
+        rankCpus[r] = numa_node_cpus(nodes[r % nodes.size()]);
+
+    size_t planeSize = static_cast<size_t>(width) * height;
+    size_t bytes = sizeof(MPControl) + sizeof(int) * workers + 2 * planeSize * workers;
+
+    void* mem = map_shared_segment(bytes);
+    if (!mem)
+        return false;
+
+    MPControl* ctl = static_cast<MPControl*>(mem);
+    ctl->workers = workers;
+    ctl->done = 0;
+
+    pthread_barrierattr_t attr;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_barrier_init(&ctl->barrier, &attr, workers);
+    pthread_barrierattr_destroy(&attr);
+
+    std::vector<pid_t> pids;
+    pids.reserve(workers);
+    bool ok = true;
+    for (int r = 0; r < workers; r++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // an exception must never unwind into the caller's code inside the forked copy
+            bool workerOk = false;
+            try {
+                workerOk = thin_slab_worker(width, height, depth, load, store, ctl, r, rankCpus[r]);
+            }
+            catch (...) {
+                _exit(1);
+            }
+            _exit(workerOk ? 0 : 1);
+        }
+        if (pid < 0) {
+            ok = false;
+            break;
+        }
+        pids.push_back(pid);
+    }
+
+    // a dead or missing worker would leave the others waiting on the barrier forever,
+    // so every worker is polled and the rest are killed on the first failure
+    if (!ok)
+        for (pid_t pid : pids) kill(pid, SIGKILL);
+    std::vector<bool> exited(pids.size(), false);
+    size_t running = pids.size();
+    while (running > 0) {
+        bool reaped = false;
+        for (size_t i = 0; i < pids.size(); i++) {
+            if (exited[i])
+                continue;
+            int status = 0;
+            pid_t pid = waitpid(pids[i], &status, WNOHANG);
+            if (pid == 0)
+                continue;
+            exited[i] = true;
+            reaped = true;
+            running--;
+            if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                if (ok)
+                    for (size_t j = 0; j < pids.size(); j++)
+                        if (!exited[j]) kill(pids[j], SIGKILL);
+                ok = false;
+            }
+        }
+        if (!reaped)
+            usleep(1000);
+    }
+
+    pthread_barrier_destroy(&ctl->barrier);
+    munmap(mem, bytes);
+    return ok;
+}
+
+
+/**
+     * In-memory form of computeThinImageMP for a volume that fits in the calling process.
+     * The workers read their slab from the (copy-on-write) volume and write the result into a
+     * shared byte per voxel, copied back at the end: peak memory is about 9 bytes per voxel,
+     * against 4 for computeThinImage. Use the SlabIO form for volumes that do not fit.
+     * Same threading restriction as the SlabIO form.
+     *
+     * @param volume volume to thin in place
+     * @param workers number of worker processes (0 = one per NUMA node); capped at Z
+     * @return false on any failure; the volume is left unchanged in that case
+     */
+bool computeThinImageMP(Volume& volume, int workers = 0) {
+    int width = volume.X();
+    int height = volume.Y();
+    int depth = volume.Z();
+    if (depth == 0)
+        return true;
+
+    size_t planeSize = static_cast<size_t>(width) * height;
+    size_t bytes = planeSize * depth;
+    uint8_t* result = static_cast<uint8_t*>(map_shared_segment(bytes));
+    if (!result)
+        return false;
+
+    SlabIO load = [&](Volume& slab, int z0, int z1) {
+        for (int z = z0; z < z1; z++)
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                    slab(x, y, z - z0 + 1) = volume(x, y, z);
+        return true;
+    };
+    SlabIO store = [&](Volume& slab, int z0, int z1) {
+        for (int z = z0; z < z1; z++)
+            store_plane(slab, z - z0 + 1, result + static_cast<size_t>(z) * planeSize);
+        return true;
+    };
+
+    bool ok = computeThinImageMP(width, height, depth, load, store, workers);
+    if (ok) {
+        for (int z = 0; z < depth; z++)
+            load_plane(volume, z, result + static_cast<size_t>(z) * planeSize);
+    }
+
+    munmap(result, bytes);
+    return ok;
+}
@@ -0,0 +1,189 @@
+/*
+__author__    = 'Meher Niger <mniger@uh.edu>'
+__copyright__ = 'Copyright 2025 by Meher Niger'
+*/
+
+// Checks of the multi-process thinning (Linux only):
+//   g++ -std=c++17 -O2 -I<tira include dir> -I.. lee_thinning_mp_test.cpp -lpthread -o lee_thinning_mp_test
+// For several worker counts, repeated runs on the same input must give the same skeleton,
+// and the skeleton must have as many 26-connected components as the sequential
+// computeThinImage result. (That one can itself lose a component: its second pass only
+// re-checks simplicity, which an isolated voxel passes.)
+// The SlabIO form, which never builds the whole volume in one process, must give the same
+// skeleton as the in-memory form.
+
+#include "lee_thinning_mp.h"
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+
+
+std::vector<int> flatten(Volume& vol) {
+    std::vector<int> voxels;
+    for (int z = 0; z < (int)vol.Z(); z++)
+        for (int y = 0; y < (int)vol.Y(); y++)
+            for (int x = 0; x < (int)vol.X(); x++)
+                voxels.push_back(vol(x, y, z));
+    return voxels;
+}
+
+int count_components(Volume& vol) {
+    int width = vol.X();
+    int height = vol.Y();
+    int depth = vol.Z();
+    std::vector<char> seen(static_cast<size_t>(width) * height * depth, 0);
+    int components = 0;
+
+    for (int z = 0; z < depth; z++) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                size_t i = (static_cast<size_t>(z) * height + y) * width + x;
+                if (vol(x, y, z) != 1 || seen[i])
+                    continue;
+
+                components++;
+                seen[i] = 1;
+                PointList stack = { { x, y, z } };
+                while (!stack.empty()) {
+                    Point p = stack.back();
+                    stack.pop_back();
+                    for (int dz = -1; dz <= 1; dz++)
+                        for (int dy = -1; dy <= 1; dy++)
+                            for (int dx = -1; dx <= 1; dx++) {
+                                int nx = p[0] + dx, ny = p[1] + dy, nz = p[2] + dz;
+                                if (get_pixel(vol, nx, ny, nz) != 1)
+                                    continue;
+                                size_t j = (static_cast<size_t>(nz) * height + ny) * width + nx;
+                                if (!seen[j]) {
+                                    seen[j] = 1;
+                                    stack.push_back({ nx, ny, nz });
+                                }
+                            }
+                }
+            }
+        }
+    }
+    return components;
+}
+
+// Union of random balls, the kind of input that puts candidates on every slab edge
+Volume random_blobs(int width, int height, int depth, int balls, unsigned seed) {
+    Volume vol(width, height, depth);
+    std::mt19937 rng(seed);
+    for (int b = 0; b < balls; b++) {
+        int cx = rng() % width, cy = rng() % height, cz = rng() % depth, r = 3 + rng() % 5;
+        for (int z = 0; z < depth; z++)
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++) {
+                    int dx = x - cx, dy = y - cy, dz = z - cz;
+                    if (dx * dx + dy * dy + dz * dz <= r * r)
+                        vol(x, y, z) = 1;
+                }
+    }
+    return vol;
+}
+
+
+int main() {
+    const int runs = 50;
+    int failures = 0;
+
+    for (unsigned seed = 1; seed <= 4; seed++) {
+        Volume input = random_blobs(40, 40, 12 + 6 * seed, 8, seed);
+        Volume sequential = input;
+        computeThinImage(sequential);
+        int expectedComponents = count_components(sequential);
+
+        for (int workers : { 2, 3, 6 }) {
+            std::vector<int> first;
+            for (int run = 0; run < runs; run++) {
+                Volume vol = input;
+                if (!computeThinImageMP(vol, workers)) {
+                    std::printf("seed %u, %d workers: computeThinImageMP failed\n", seed, workers);
+                    failures++;
+                    break;
+                }
+
+                std::vector<int> voxels = flatten(vol);
+                if (run == 0) {
+                    first = voxels;
+                    int components = count_components(vol);
+                    if (components != expectedComponents) {
+                        std::printf("seed %u, %d workers: %d components, computeThinImage gives %d\n",
+                            seed, workers, components, expectedComponents);
+                        failures++;
+                    }
+                }
+                else if (voxels != first) {
+                    std::printf("seed %u, %d workers: run %d differs from run 0\n", seed, workers, run);
+                    failures++;
+                    break;
+                }
+            }
+        }
+    }
+
+    // SlabIO form: every worker copies its planes out of a regenerated input (a real loader would
+    // read only those planes from disk) and writes them to a raw byte file
+    {
+        int width = 40, height = 40, depth = 30;
+        Volume input = random_blobs(width, height, depth, 8, 7);
+        Volume expected = input;
+        computeThinImageMP(expected, 3);
+
+        char path[] = "/tmp/lee_thinning_mp_testXXXXXX";
+        int fd = mkstemp(path);
+        unlink(path);
+        size_t planeSize = static_cast<size_t>(width) * height;
+
+        SlabIO load = [&](Volume& slab, int z0, int z1) {
+            Volume blobs = random_blobs(width, height, depth, 8, 7);
+            for (int z = z0; z < z1; z++)
+                for (int y = 0; y < height; y++)
+                    for (int x = 0; x < width; x++)
+                        slab(x, y, z - z0 + 1) = blobs(x, y, z);
+            return true;
+        };
+        SlabIO store = [&](Volume& slab, int z0, int z1) {
+            std::vector<uint8_t> plane(planeSize);
+            for (int z = z0; z < z1; z++) {
+                store_plane(slab, z - z0 + 1, plane.data());
+                off_t offset = static_cast<off_t>(z) * planeSize;
+                if (pwrite(fd, plane.data(), planeSize, offset) != static_cast<ssize_t>(planeSize))
+                    return false;
+            }
+            return true;
+        };
+
+        if (!computeThinImageMP(width, height, depth, load, store, 3)) {
+            std::printf("SlabIO form failed\n");
+            failures++;
+        }
+        else {
+            std::vector<uint8_t> plane(planeSize);
+            bool same = true;
+            for (int z = 0; z < depth && same; z++) {
+                if (pread(fd, plane.data(), planeSize, static_cast<off_t>(z) * planeSize) != static_cast<ssize_t>(planeSize))
+                    same = false;
+                for (int y = 0; y < height && same; y++)
+                    for (int x = 0; x < width; x++)
+                        if (plane[y * width + x] != expected(x, y, z)) same = false;
+            }
+            if (!same) {
+                std::printf("SlabIO form differs from the in-memory form\n");
+                failures++;
+            }
+        }
+
+        // a failing load must make the whole call fail instead of hanging the other workers
+        SlabIO failingLoad = [&](Volume& slab, int z0, int z1) { return z0 == 0 ? false : load(slab, z0, z1); };
+        if (computeThinImageMP(width, height, depth, failingLoad, store, 3)) {
+            std::printf("a failing load was not reported\n");
+            failures++;
+        }
+        close(fd);
+    }
+
+    std::printf(failures ? "FAILED\n" : "passed\n");
+    return failures ? 1 : 0;
+}